@@ -90,6 +90,56 @@ template<int bitpos, int bits>
     }
   };
 
+//----------------------------------
+// Header decoder
+//----------------------------------
+
+// Loads a big-endian word of 1 to 8 bytes.
+template<int bytes>
+  class LOAD {
+  public:
+    static u_int64_t get(const u_int8_t *p) {
+      return (LOAD<bytes - 1>::get(p) << 8) | p[bytes - 1];
+    }
+  };
+
+template<>
+  class LOAD<1> {
+  public:
+    static u_int64_t get(const u_int8_t *p) {
+      return p[0];
+    }
+  };
+
+// Describes a field in a header layout.
+// `bitpos` is counted from the most significant bit of the header.
+template<int bitpos_, int bits_>
+  struct FIELD {
+    static constexpr int bitpos = bitpos_;
+    static constexpr int bits = bits_;
+  };
+
+// Decodes fields of a header of 1 to 8 bytes.
+// The header is loaded once as a word, then each field is taken out
+// with a shift and a mask.
+template<int bytes>
+  class HEADER {
+    static_assert(bytes >= 1 && bytes <= 8, "HEADER supports 1 to 8 bytes");
+    static constexpr int BITS = bytes * 8;
+  public:
+    explicit HEADER(const u_int8_t *p) : word(LOAD<bytes>::get(p)) {}
+
+    template<class F>
+      u_int64_t get() const {
+        static_assert(F::bits > 0 && F::bitpos >= 0 && F::bitpos + F::bits <= BITS,
+                      "field is out of the header");
+        return (word >> (BITS - F::bitpos - F::bits)) & (~(u_int64_t)0 >> (64 - F::bits));
+      }
+
+  private:
+    u_int64_t word;
+  };
+
 } // namespace
 
 #endif // ACCESSOR_H_
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2014, Iwasa Kazmi
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <algorithm>
+
+#include "filter.h"
+
+namespace TS {
+
+static void printDebug(const char *format, ...) {
+#ifdef DEBUG
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+#endif
+}
+
+Filter::Filter(const Output &output_)
+  : output(output_),
+    patPsi(),
+    pmtPsi(),
+    pmtPidSet(),
+    dropPidSet(),
+    esPidSet(),
+    continuity(),
+    dropDuplicates(false),
+    alignSwitching(false),
+    started(true),
+    pmtReceived(false),
+    videoPid(-1),
+    pendingSize(0),
+    inSync(false),
+    syncLosses(0) {
+  memset(forwarding, 1, sizeof(forwarding));
+}
+
+void Filter::setWaitRandomAccess(bool wait) {
+  if (wait)
+    alignSwitching = true;
+  started = !wait;
+  memset(forwarding, started ? 1 : 0, sizeof(forwarding));
+}
+
+void Filter::push(const u_int8_t *data, size_t size) {
+  const u_int8_t *p = data;
+  const u_int8_t * const end = data + size;
+
+  // complete the packet left by the previous chunk
+  if (pendingSize > 0) {
+    const size_t len = std::min(Packet::SIZE - pendingSize, size);
+    memcpy(&pending[pendingSize], p, len);
+    pendingSize += len;
+    p += len;
+    if (pendingSize < Packet::SIZE)
+      return;
+
+    pendingSize = 0;
+    inSync = true;
+    bool drop = checkPacket(Packet(pending));
+    if (drop) {
+      printDebug("--> drop\n");
+    } else {
+      printDebug("--> keep\n");
+      output(pending, Packet::SIZE);
+    }
+  }
+
+  // consecutive packets to keep are reported as one range
+  const u_int8_t *keepStart = p;
+  const u_int8_t *keepEnd = p;
+
+  while (p < end) {
+    if (*p != Packet::SYNCBYTE) {
+      if (inSync) {
+        printDebug("missing sync-byte\n");
+        inSync = false;
+        syncLosses++;
+      }
+      p = static_cast<const u_int8_t *>(memchr(p, Packet::SYNCBYTE, end - p));
+      if (!p)
+        break;
+    }
+
+    if (static_cast<size_t>(end - p) < Packet::SIZE) {
+      pendingSize = end - p;
+      memcpy(pending, p, pendingSize);
+      break;
+    }
+
+    inSync = true;
+    bool drop = checkPacket(Packet(p));
+    if (drop) {
+      printDebug("--> drop\n");
+    } else {
+      printDebug("--> keep\n");
+      if (p != keepEnd) {
+        if (keepStart != keepEnd)
+          output(keepStart, keepEnd - keepStart);
+        keepStart = p;
+      }
+      keepEnd = p + Packet::SIZE;
+    }
+    p += Packet::SIZE;
+  }
+
+  if (keepStart != keepEnd)
+    output(keepStart, keepEnd - keepStart);
+}
+
+void Filter::feedPAT(const Packet &packet) {
+  bool completed = patPsi.feed(packet);
+  if (!completed)
+    return;
+
+  printDebug("pasre PAT\n");
+
+  pmtPidSet.clear();
+
+  PATSection section = patPsi.firstSection();
+  for (;;) {
+    auto iterator = section.iterator();
+    while(iterator.hasNext()) {
+      const auto entry = iterator.next();
+
+      int programNumber = entry.programNumber();
+      int pid = entry.pid();
+      printDebug("PAT: prog:%d  pid:%d\n", programNumber, pid);
+      if (programNumber != 0) {
+        pmtPidSet.insert(pid);
+        break;
+      }
+    }
+
+    if (section.isLastSection())
+      break;
+    section = section.nextSection();
+  }
+}
+
+void Filter::feedPMT(const Packet &packet) {
+  bool completed = pmtPsi.feed(packet);
+  if (!completed)
+    return;
+
+  printDebug("pasre PMT\n");
+
+  bool hasVideo = false;
+  bool hasAudio = false;
+
+  dropPidSet.clear();
+  esPidSet.clear();
+  pmtReceived = true;
+  videoPid = -1;
+
+  PMTSection section = pmtPsi.firstSection();
+  for (;;) {
+    auto iterator = section.iterator();
+    while(iterator.hasNext()) {
+      const auto entry = iterator.next();
+
+      int streamType = entry.streamType();
+      int pid = entry.elementaryPid();
+      printDebug("PMT: streamType:%d  pid:%d\n", streamType, pid);
+      esPidSet.insert(pid);
+
+      switch (streamType) {
+        case 2: // ISO/IEC 13818-2
+          if (hasVideo) {
+            dropPidSet.insert(pid);
+          } else {
+            hasVideo = true;
+            videoPid = pid;
+          }
+          break;
+
+        case 0xf: // ISO/IEC 13818-7
+          if (hasAudio) {
+            dropPidSet.insert(pid);
+          } else {
+            hasAudio = true;
+          }
+          break;
+
+        default:
+          dropPidSet.insert(pid);
+          break;
+      } 
+    }
+
+    if (section.isLastSection())
+      break;
+    section = section.nextSection();
+  }
+}
+
+bool Filter::checkPacket(const Packet &packet) {
+  printDebug("SI:%d PID:%d hasAF:%d hasPL:%d ct:%d\n",
+    packet.payloadUnitStartIndicator(),
+    packet.pid(),
+    packet.hasAdaptationField(),
+    packet.hasPayload(),
+    packet.continuityCounter());
+
+  switch (continuity.check(packet)) {
+    case ContinuityChecker::CONTINUOUS:
+      break;
+
+    case ContinuityChecker::DUPLICATE:
+      printDebug("duplicate packet\n");
+      if (dropDuplicates)
+        return true;
+      break;
+
+    case ContinuityChecker::DISCONTINUOUS:
+      printDebug("continuity error\n");
+      break;
+  }
+
+  // packets without payload are kept, except before the first random access point
+  if (!packet.hasPayload())
+    return !started;
+
+  const auto pid = packet.pid();
+
+  if (pid == PID::PAT) {
+    feedPAT(packet);
+    return false;
+  }
+  if (pmtPidSet.find(pid) != pmtPidSet.end()) {
+    feedPMT(packet);
+    return false;
+  }
+
+  const bool keep = dropPidSet.find(pid) == dropPidSet.end();
+  if (!alignSwitching)
+    return !keep;
+  return !switchStream(packet, keep);
+}
+
+bool Filter::switchStream(const Packet &packet, bool keep) {
+  const auto pid = packet.pid();
+  if (forwarding[pid] == keep)
+    return keep;
+
+  // PIDs other than the elementary streams in PMT (e.g. null packets) have
+  // no PES packets to align to; they start right after the first random
+  // access point
+  if (keep && started && esPidSet.find(pid) == esPidSet.end()) {
+    printDebug("start PID:%d\n", pid);
+    forwarding[pid] = 1;
+    return true;
+  }
+
+  // the previous PES packet ends here
+  if (!packet.payloadUnitStartIndicator())
+    return !keep;
+
+  if (!keep) {
+    printDebug("stop PID:%d\n", pid);
+    forwarding[pid] = 0;
+    return false;
+  }
+
+  const bool randomAccess = pid != videoPid
+    || (packet.hasAdaptationField()
+        && packet.adaptationFieldLength() > 0
+        && packet.randomAccessIndicator());
+  if (!randomAccess)
+    return false;
+
+  if (!started) {
+    // the video stream (if any) must be known to find the first random access point
+    if (!pmtReceived || (videoPid >= 0 && pid != videoPid))
+      return false;
+    printDebug("first random access point PID:%d\n", pid);
+    started = true;
+  }
+
+  printDebug("start PID:%d\n", pid);
+  forwarding[pid] = 1;
+  return true;
+}
+
+} // namespace
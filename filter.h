@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014, Iwasa Kazmi
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <sys/types.h>
+
+#include <functional>
+#include <set>
+
+#include "ts.h"
+
+namespace TS {
+
+//
+// Transport stream filter
+//
+// Filter accepts a transport stream in arbitrary-sized chunks and reports
+// the packets to keep through the output callback. A packet split across
+// chunks is completed from the following chunk.
+//
+// A Filter object has no shared state, so separate objects can be used
+// on separate threads without locking.
+//
+class Filter {
+public:
+  // Called with a range of consecutive packets to keep.
+  // The range is valid only during the call.
+  typedef std::function<void(const u_int8_t *data, size_t size)> Output;
+
+  explicit Filter(const Output &output_);
+
+  // feeds the next chunk of the stream
+  void push(const u_int8_t *data, size_t size);
+
+  // drops the second of two packets sent with the same continuity counter
+  void setDropDuplicates(bool drop) { dropDuplicates = drop; }
+
+  // starts and stops forwarding a stream only at the beginning of a PES
+  // packet (at a random access point for the video stream) when the
+  // streams to keep are changed by a PMT update.
+  void setAlignSwitching(bool align) { alignSwitching = align; }
+
+  // drops all packets other than PAT and PMT until a random access point
+  // of the video stream appears, then starts forwarding each elementary
+  // stream at the beginning of its PES packet, and other PIDs at once.
+  // implies setAlignSwitching(true). must be called before the first
+  // push().
+  void setWaitRandomAccess(bool wait);
+
+  // number of times the sync-byte was missing where a packet was expected
+  unsigned long syncLossCount() const { return syncLosses; }
+
+  // estimated number of packets lost in the PID
+  unsigned long lossCount(int pid) const { return continuity.lossCount(pid); }
+
+private:
+  Output output;
+
+  PSI patPsi;
+  PSI pmtPsi;
+  std::set<int> pmtPidSet;
+  std::set<int> dropPidSet;
+  std::set<int> esPidSet;   // elementary streams listed in PMT
+
+  ContinuityChecker continuity;
+  bool dropDuplicates;
+
+  // switching streams at PES boundaries
+  bool alignSwitching;
+  bool started;       // first random access point has been passed
+  bool pmtReceived;
+  int videoPid;       // -1 if the program has no video stream to keep
+  u_int8_t forwarding[PID::Count];
+
+  // packet split across chunks
+  u_int8_t pending[Packet::SIZE];
+  size_t pendingSize;
+
+  bool inSync;
+  unsigned long syncLosses;
+
+  void feedPAT(const Packet &packet);
+  void feedPMT(const Packet &packet);
+
+  // returns true if the packet should be dropped
+  bool checkPacket(const Packet &packet);
+
+  // returns true if the packet should be forwarded
+  bool switchStream(const Packet &packet, bool keep);
+};
+
+} // namespace
+
+#endif // FILTER_H_
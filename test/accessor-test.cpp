@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <vector>
 #include "accessor.h"
+#include "ts.h"
 
 using namespace BitFieldAccessor;
 
@@ -63,6 +64,64 @@ int main() {
   EQUALS((INT<15,2>::get(Bytes{0x00, 0x01, 0x80})), 0x03);
   EQUALS((INT<15,3>::get(Bytes{0x00, 0x01, 0x80})), 0x06);
   //EQUALS((INT<7,10>::get(Bytes{0x01, 0xff, 0x80})), 0x3ff); // should fail to compile
+
+  EQUALS(LOAD<1>::get(Bytes{0x81, 0x02}), 0x81u);
+  EQUALS(LOAD<2>::get(Bytes{0x81, 0x02, 0x03}), 0x8102u);
+  EQUALS(LOAD<3>::get(Bytes{0x81, 0x02, 0x03, 0x04}), 0x810203u);
+  EQUALS(LOAD<5>::get(Bytes{0x81, 0x02, 0x03, 0x04, 0x05, 0x06}), 0x8102030405ull);
+  EQUALS(LOAD<8>::get(Bytes{0x81, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}), 0x8102030405060708ull);
+
+  EQUALS((HEADER<1>(Bytes{0xa0}).get<FIELD<0,1>>()), 0x01u);
+  EQUALS((HEADER<1>(Bytes{0xa0}).get<FIELD<0,3>>()), 0x05u);
+  EQUALS((HEADER<1>(Bytes{0x81}).get<FIELD<0,8>>()), 0x81u);
+  EQUALS((HEADER<1>(Bytes{0x41}).get<FIELD<1,7>>()), 0x41u);
+  EQUALS((HEADER<3>(Bytes{0x01, 0xff, 0x80}).get<FIELD<7,10>>()), 0x3ffu);
+  EQUALS((HEADER<3>(Bytes{0x80, 0x01, 0x80}).get<FIELD<0,17>>()), 0x10003u);
+  EQUALS((HEADER<4>(Bytes{0x47, 0x41, 0x00, 0x1a}).get<FIELD<11,13>>()), 0x100u);
+  EQUALS((HEADER<4>(Bytes{0x47, 0x41, 0x00, 0x1a}).get<FIELD<28,4>>()), 0x0au);
+  EQUALS((HEADER<4>(Bytes{0x47, 0x41, 0x00, 0x1a}).get<FIELD<9,1>>()), 0x01u);
+
+  // 33 bits
+  EQUALS((HEADER<5>(Bytes{0xff, 0xff, 0xff, 0xff, 0x80}).get<FIELD<0,33>>()), 0x1ffffffffull);
+  EQUALS((HEADER<5>(Bytes{0x80, 0x00, 0x00, 0x00, 0x7f}).get<FIELD<0,33>>()), 0x100000000ull);
+  EQUALS((HEADER<6>(Bytes{0x40, 0x00, 0x00, 0x00, 0x40, 0x00}).get<FIELD<1,33>>()), 0x100000001ull);
+  // 42 bits
+  EQUALS((HEADER<6>(Bytes{0x3f, 0xff, 0xff, 0xff, 0xff, 0xfe}).get<FIELD<2,42>>()), 0x3ffffffffffull);
+  EQUALS((HEADER<6>(Bytes{0x20, 0x00, 0x00, 0x00, 0x00, 0x10}).get<FIELD<2,42>>()), 0x20000000001ull);
+  // 64 bits
+  EQUALS((HEADER<8>(Bytes{0x81, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}).get<FIELD<0,64>>()), 0x8102030405060708ull);
+  EQUALS((HEADER<8>(Bytes{0x81, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}).get<FIELD<56,8>>()), 0x08u);
+  //EQUALS((HEADER<2>(Bytes{0x81, 0x02}).get<FIELD<8,9>>()), 0x00u); // should fail to compile
+  //EQUALS((HEADER<9>(Bytes{0x81, 0x02}).get<FIELD<0,8>>()), 0x81u); // should fail to compile
+
+  // PCR / OPCR: base 0x123456789, extension 0x1ab / base 0x1ffffffff, extension 299
+  Bytes af{0x47, 0x01, 0x00, 0x30, 0x0d, 0x18,
+           0x91, 0xa2, 0xb3, 0xc4, 0xff, 0xab,
+           0xff, 0xff, 0xff, 0xff, 0xff, 0x2b};
+  af.resize(TS::Packet::SIZE);
+  EQUALS(TS::Packet(af).pcrFlag(), true);
+  EQUALS(TS::Packet(af).opcrFlag(), true);
+  EQUALS(TS::Packet(af).pcr(), 0x123456789ll * 300 + 0x1ab);
+  EQUALS(TS::Packet(af).opcr(), 0x1ffffffffll * 300 + 299);
+
+  // PTS 0x123456789 / DTS 0x187654321 with marker bits
+  Bytes pes{0x00, 0x00, 0x01, 0xe0, 0x00, 0x00, 0x80, 0xc0, 0x0a,
+            0x39, 0x8d, 0x15, 0xcf, 0x13,
+            0x1d, 0x1d, 0x95, 0x86, 0x43};
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).isValid(), true);
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).streamId(), 0xe0);
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).hasPts(), true);
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).hasDts(), true);
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).pts(), 0x123456789ll);
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size())).dts(), 0x187654321ll);
+
+  // PTS and DTS announced without room for them
+  EQUALS(TS::PESHeader(TS::Payload(pes, pes.size() - 1)).isValid(), false);
+  Bytes pts0{0x00, 0x00, 0x01, 0xe0, 0x00, 0x00, 0x80, 0x80, 0x00};
+  EQUALS(TS::PESHeader(TS::Payload(pts0, pts0.size())).isValid(), false);
+  Bytes dts5{0x00, 0x00, 0x01, 0xe0, 0x00, 0x00, 0x80, 0xc0, 0x05,
+             0x39, 0x8d, 0x15, 0xcf, 0x13};
+  EQUALS(TS::PESHeader(TS::Payload(dts5, dts5.size())).isValid(), false);
   
   return failCount;
 }
@@ -0,0 +1,644 @@
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+#include "filter.h"
+
+int failCount = 0;
+
+void assert_(const char *expr, bool cond) {
+  const char *result = cond ? "PASS" : "FAIL";
+  printf("%s ...... %s\n", expr, result);
+  if (!cond)
+    failCount++;
+}
+
+#define EQUALS(expr, expected) assert_(#expr, (expr) == (expected))
+
+typedef std::vector<u_int8_t> Bytes;
+
+//----------------------------------
+// Fixture builders
+//----------------------------------
+
+u_int32_t crc32(const u_int8_t *p, size_t size) {
+  u_int32_t crc = 0xffffffff;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= (u_int32_t)p[i] << 24;
+    for (int b = 0; b < 8; ++b)
+      crc = (crc & 0x80000000) ? ((crc << 1) ^ 0x04c11db7) : (crc << 1);
+  }
+  return crc;
+}
+
+// a section with section_syntax_indicator == 1
+Bytes section(int tableId, int tableIdExtension, int version,
+              int sectionNumber, int lastSectionNumber, const Bytes &body) {
+  const int length = 5 + body.size() + 4;
+  Bytes s = {
+    (u_int8_t)tableId,
+    (u_int8_t)(0xb0 | (length >> 8)), (u_int8_t)length,
+    (u_int8_t)(tableIdExtension >> 8), (u_int8_t)tableIdExtension,
+    (u_int8_t)(0xc1 | (version << 1)),
+    (u_int8_t)sectionNumber, (u_int8_t)lastSectionNumber,
+  };
+  s.insert(s.end(), body.begin(), body.end());
+  const u_int32_t crc = crc32(s.data(), s.size());
+  s.push_back(crc >> 24);
+  s.push_back(crc >> 16);
+  s.push_back(crc >> 8);
+  s.push_back(crc);
+  return s;
+}
+
+struct Program {
+  int programNumber;
+  int pid;
+};
+
+Bytes pat(const std::vector<Program> &programs, int version = 0,
+          int sectionNumber = 0, int lastSectionNumber = 0) {
+  Bytes body;
+  for (const auto &p : programs) {
+    body.push_back(p.programNumber >> 8);
+    body.push_back(p.programNumber);
+    body.push_back(0xe0 | (p.pid >> 8));
+    body.push_back(p.pid);
+  }
+  return section(0x00, 1, version, sectionNumber, lastSectionNumber, body);
+}
+
+struct Stream {
+  int streamType;
+  int pid;
+  int esInfoLength;
+};
+
+Bytes pmt(int pcrPid, const std::vector<Stream> &streams, int version = 0,
+          int sectionNumber = 0, int lastSectionNumber = 0) {
+  Bytes body = {
+    (u_int8_t)(0xe0 | (pcrPid >> 8)), (u_int8_t)pcrPid,
+    0xf0, 0x00,
+  };
+  for (const auto &s : streams) {
+    body.push_back(s.streamType);
+    body.push_back(0xe0 | (s.pid >> 8));
+    body.push_back(s.pid);
+    body.push_back(0xf0 | (s.esInfoLength >> 8));
+    body.push_back(s.esInfoLength);
+    // dummy descriptors
+    body.insert(body.end(), s.esInfoLength, 0x00);
+  }
+  return section(0x02, 1, version, sectionNumber, lastSectionNumber, body);
+}
+
+class Builder {
+public:
+  Builder() : counters(TS::PID::Count, 0) {}
+
+  // appends a packet carrying `payload` (at most 184 bytes, padded with 0xff)
+  Bytes &packet(int pid, const Bytes &payload, bool start = false,
+                bool randomAccess = false, bool discontinuity = false) {
+    const int counter = counters[pid];
+    counters[pid] = (counter + 1) % 16;
+    return rawPacket(pid, counter, payload, start, randomAccess, discontinuity);
+  }
+
+  Bytes &rawPacket(int pid, int counter, const Bytes &payload, bool start = false,
+                   bool randomAccess = false, bool discontinuity = false) {
+    const bool hasAF = randomAccess || discontinuity;
+    data.push_back(TS::Packet::SYNCBYTE);
+    data.push_back((start ? 0x40 : 0x00) | (pid >> 8));
+    data.push_back(pid);
+    data.push_back((hasAF ? 0x30 : 0x10) | counter);
+    size_t space = 184;
+    if (hasAF) {
+      data.push_back(1);
+      data.push_back((discontinuity ? 0x80 : 0) | (randomAccess ? 0x40 : 0));
+      space -= 2;
+    }
+    for (size_t i = 0; i < space; ++i)
+      data.push_back(i < payload.size() ? payload[i] : 0xff);
+    return data;
+  }
+
+  // appends a packet with an adaptation field and no payload
+  Bytes &adaptationOnly(int pid) {
+    data.push_back(TS::Packet::SYNCBYTE);
+    data.push_back(pid >> 8);
+    data.push_back(pid);
+    data.push_back(0x20 | counters[pid]);
+    data.push_back(183);
+    data.insert(data.end(), 183, 0x00);
+    return data;
+  }
+
+  // appends PSI sections split into packets
+  void psi(int pid, const Bytes &sections) {
+    Bytes rest = { 0x00 };  // pointer_field
+    rest.insert(rest.end(), sections.begin(), sections.end());
+    bool start = true;
+    while (!rest.empty()) {
+      const size_t len = std::min(rest.size(), (size_t)184);
+      packet(pid, Bytes(rest.begin(), rest.begin() + len), start);
+      rest.erase(rest.begin(), rest.begin() + len);
+      start = false;
+    }
+  }
+
+  // appends `n` packets of `pid`, marking one of every `unit` packets as
+  // the start of a PES packet
+  void es(int pid, int n, int unit = 1) {
+    for (int i = 0; i < n; ++i)
+      packet(pid, Bytes{ (u_int8_t)pid, (u_int8_t)i }, i % unit == 0);
+  }
+
+  Bytes data;
+  std::vector<int> counters;
+};
+
+//----------------------------------
+// Engines
+//----------------------------------
+
+struct Options {
+  bool dropDuplicates;
+  bool alignSwitching;
+  bool waitRandomAccess;
+};
+
+const Options OPTIONS[] = {
+  { false, false, false },
+  { true,  false, false },
+  { false, true,  false },
+  { false, false, true  },
+  { true,  true,  true  },
+};
+
+// output and counters of a filter run
+struct Result {
+  Bytes output;
+  unsigned long syncLosses;
+  std::vector<unsigned long> losses;  // indexed by PID
+};
+
+// pushes `input` in chunks of `chunk` bytes (0 = random sizes)
+Result filter(const Bytes &input, size_t chunk, const Options &options = OPTIONS[0]) {
+  Result result;
+  TS::Filter f([&result](const u_int8_t *data, size_t size) {
+    result.output.insert(result.output.end(), data, data + size);
+  });
+  f.setDropDuplicates(options.dropDuplicates);
+  f.setAlignSwitching(options.alignSwitching);
+  if (options.waitRandomAccess)
+    f.setWaitRandomAccess(true);
+
+  // chunk sizes have their own generator so that the callers' random
+  // sequences are not disturbed
+  std::minstd_rand rng(chunk + 1);
+  size_t pos = 0;
+  while (pos < input.size()) {
+    const size_t size = std::min(chunk ? chunk : (size_t)(rng() % 500 + 1), input.size() - pos);
+    // copy the chunk so that the filter can't depend on the previous buffer
+    Bytes buffer(input.begin() + pos, input.begin() + pos + size);
+    f.push(buffer.data(), buffer.size());
+    pos += size;
+  }
+
+  result.syncLosses = f.syncLossCount();
+  for (int pid = 0; pid < TS::PID::Count; ++pid)
+    result.losses.push_back(f.lossCount(pid));
+  return result;
+}
+
+// the reference: whole input in one push()
+Bytes reference(const Bytes &input, const Options &options = OPTIONS[0]) {
+  return filter(input, input.size(), options).output;
+}
+
+// compares every engine mode with the reference
+bool sameAsReference(const Bytes &input) {
+  static const size_t CHUNKS[] = { 1, 3, 187, 188, 189, 376, 4096, 0 };
+  for (const auto &options : OPTIONS) {
+    const Bytes expected = reference(input, options);
+    for (size_t chunk : CHUNKS) {
+      if (filter(input, chunk, options).output != expected) {
+        printf("  differs: chunk=%zu options={%d,%d,%d}\n", chunk,
+          options.dropDuplicates, options.alignSwitching, options.waitRandomAccess);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// PIDs of the output packets
+std::vector<int> pids(const Bytes &ts) {
+  std::vector<int> result;
+  for (size_t i = 0; i + TS::Packet::SIZE <= ts.size(); i += TS::Packet::SIZE)
+    result.push_back(TS::Packet(&ts[i]).pid());
+  return result;
+}
+
+// number of output packets of `pid`
+int count(const Bytes &ts, int pid) {
+  int n = 0;
+  for (int p : pids(ts))
+    n += (p == pid);
+  return n;
+}
+
+//----------------------------------
+// Fixtures
+//----------------------------------
+
+const int PMT_PID = 0x100;
+const int VIDEO = 0x111;
+const int AUDIO = 0x112;
+const int AUDIO2 = 0x113;
+const int DATA = 0x114;
+const int OTHER = 0x120;  // not listed in PMT
+
+const std::vector<Stream> STREAMS = {
+  { 0x02, VIDEO, 0 },
+  { 0x0f, AUDIO, 0 },
+  { 0x0f, AUDIO2, 0 },
+  { 0x06, DATA, 0 },
+};
+
+Builder basicStream() {
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 0, 0x10 }, { 1, PMT_PID } }));
+  s.psi(PMT_PID, pmt(VIDEO, STREAMS));
+  for (int i = 0; i < 4; ++i) {
+    s.es(VIDEO, 3);
+    s.es(AUDIO, 2);
+    s.es(AUDIO2, 2);
+    s.es(DATA, 1);
+    s.es(OTHER, 1);
+    s.es(TS::PID::Null, 1);
+  }
+  return s;
+}
+
+void testBasic() {
+  const Bytes input = basicStream().data;
+  const Bytes out = reference(input);
+  EQUALS(out.size() % TS::Packet::SIZE, 0u);
+  EQUALS(count(out, TS::PID::PAT), 1);
+  EQUALS(count(out, PMT_PID), 1);
+  EQUALS(count(out, VIDEO), 12);
+  EQUALS(count(out, AUDIO), 8);
+  EQUALS(count(out, AUDIO2), 0);
+  EQUALS(count(out, DATA), 0);
+  EQUALS(count(out, OTHER), 4);
+  EQUALS(count(out, TS::PID::Null), 4);
+  EQUALS(sameAsReference(input), true);
+
+  // kept packets are not modified
+  const Bytes in2 = reference(out);
+  EQUALS(in2 == out, true);
+}
+
+void testMultiSection() {
+  Builder s;
+  Bytes pats = pat({ { 0, 0x10 } }, 0, 0, 1);
+  const Bytes pat2 = pat({ { 1, PMT_PID } }, 0, 1, 1);
+  pats.insert(pats.end(), pat2.begin(), pat2.end());
+  s.psi(TS::PID::PAT, pats);
+
+  Bytes pmts = pmt(VIDEO, { { 0x02, VIDEO, 0 }, { 0x06, DATA, 0 } }, 0, 0, 1);
+  const Bytes pmt2 = pmt(VIDEO, { { 0x0f, AUDIO, 0 }, { 0x0f, AUDIO2, 0 } }, 0, 1, 1);
+  pmts.insert(pmts.end(), pmt2.begin(), pmt2.end());
+  s.psi(PMT_PID, pmts);
+
+  s.es(VIDEO, 2);
+  s.es(AUDIO, 2);
+  s.es(AUDIO2, 2);
+  s.es(DATA, 2);
+
+  const Bytes out = reference(s.data);
+  EQUALS(count(out, VIDEO), 2);
+  EQUALS(count(out, AUDIO), 2);
+  EQUALS(count(out, AUDIO2), 0);
+  EQUALS(count(out, DATA), 0);
+  EQUALS(sameAsReference(s.data), true);
+}
+
+void testSplitPSI() {
+  // PMT spanning 3 packets
+  std::vector<Stream> streams = STREAMS;
+  streams[0].esInfoLength = 200;
+  streams[3].esInfoLength = 150;
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  s.psi(PMT_PID, pmt(VIDEO, streams));
+  EQUALS(s.data.size(), TS::Packet::SIZE * 4);
+  s.es(VIDEO, 2);
+  s.es(AUDIO2, 2);
+  s.es(DATA, 2);
+
+  const Bytes out = reference(s.data);
+  EQUALS(count(out, PMT_PID), 3);
+  EQUALS(count(out, VIDEO), 2);
+  EQUALS(count(out, AUDIO2), 0);
+  EQUALS(count(out, DATA), 0);
+  EQUALS(sameAsReference(s.data), true);
+}
+
+void testContinuity() {
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  s.psi(PMT_PID, pmt(VIDEO, STREAMS));
+  s.es(VIDEO, 3);
+  s.counters[VIDEO] += 2;           // 2 packets lost
+  s.es(VIDEO, 3);
+  s.rawPacket(VIDEO, 7, Bytes{}); // duplicate of the previous packet
+  s.es(VIDEO, 1);
+  s.es(AUDIO, 2);
+  s.rawPacket(AUDIO, 9, Bytes{}, true, false, true);  // discontinuity_indicator
+  s.counters[AUDIO] = 10;
+  s.es(AUDIO, 1);
+  s.counters[TS::PID::Null] += 5;   // no check for null packets
+  s.es(TS::PID::Null, 1);
+
+  Result r = filter(s.data, s.data.size());
+  EQUALS(r.losses[VIDEO], 2u);
+  EQUALS(r.losses[AUDIO], 0u);
+  EQUALS(r.losses[TS::PID::Null], 0u);
+  EQUALS(count(r.output, VIDEO), 8);
+
+  const Options drop = { true, false, false };
+  r = filter(s.data, s.data.size(), drop);
+  EQUALS(r.losses[VIDEO], 2u);
+  EQUALS(count(r.output, VIDEO), 7);
+
+  // out-of-range PIDs
+  const TS::Filter f([](const u_int8_t *, size_t) {});
+  EQUALS(f.lossCount(TS::PID::Count), 0u);
+  EQUALS(f.lossCount(-1), 0u);
+
+  EQUALS(sameAsReference(s.data), true);
+
+  // a gap in the PMT makes it unusable, so nothing is dropped
+  Builder s2;
+  std::vector<Stream> streams = STREAMS;
+  streams[0].esInfoLength = 200;
+  s2.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  const Bytes sections = pmt(VIDEO, streams);
+  Bytes first = { 0x00 };
+  first.insert(first.end(), sections.begin(), sections.begin() + 183);
+  s2.packet(PMT_PID, first, true);
+  s2.counters[PMT_PID]++;
+  s2.packet(PMT_PID, Bytes(sections.begin() + 183, sections.end()));
+  s2.es(DATA, 2);
+  EQUALS(count(reference(s2.data), DATA), 2);
+  EQUALS(sameAsReference(s2.data), true);
+}
+
+void testSyncLoss() {
+  const Builder clean = basicStream();
+  const size_t P = TS::Packet::SIZE;
+
+  // garbage between packets
+  Bytes input(clean.data.begin(), clean.data.begin() + P * 10);
+  const Bytes garbage = { 0x00, 0x01, 0x02, 0xff, 0x80 };
+  input.insert(input.end(), garbage.begin(), garbage.end());
+  input.insert(input.end(), clean.data.begin() + P * 10, clean.data.end());
+
+  Result r = filter(input, input.size());
+  EQUALS(r.syncLosses, 1u);
+  EQUALS(r.output == reference(clean.data), true);
+  EQUALS(sameAsReference(input), true);
+
+  // a packet cut short in the middle of the stream
+  input.assign(clean.data.begin(), clean.data.begin() + P * 10 + 100);
+  input.insert(input.end(), clean.data.begin() + P * 11, clean.data.end());
+  r = filter(input, input.size());
+  EQUALS(r.syncLosses, 1u);
+  EQUALS(pids(r.output).size(), pids(reference(clean.data)).size() - 1);
+  EQUALS(sameAsReference(input), true);
+
+  // a truncated stream: the partial packet at the end is not output
+  input.assign(clean.data.begin(), clean.data.end() - 100);
+  EQUALS(reference(input).size() % P, 0u);
+  EQUALS(sameAsReference(input), true);
+}
+
+void testPacketSize192() {
+  // 188-byte packets with a 4-byte prefix (BDAV MPEG-2 TS).
+  // the prefix is skipped as garbage and the packets are output without it.
+  const Builder clean = basicStream();
+  const size_t P = TS::Packet::SIZE;
+  const size_t n = clean.data.size() / P;
+  Bytes input;
+  for (size_t i = 0; i < n; ++i) {
+    const Bytes prefix = { 0x00, 0x01, (u_int8_t)(i >> 8), (u_int8_t)i };
+    input.insert(input.end(), prefix.begin(), prefix.end());
+    input.insert(input.end(), clean.data.begin() + P * i, clean.data.begin() + P * (i + 1));
+  }
+
+  const Result r = filter(input, input.size());
+  EQUALS(r.output == reference(clean.data), true);
+  EQUALS(r.syncLosses, n - 1);
+  EQUALS(sameAsReference(input), true);
+}
+
+void testVersionChange() {
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  s.psi(PMT_PID, pmt(VIDEO, STREAMS));
+  s.es(AUDIO, 4, 2);
+  s.es(AUDIO2, 4, 2);
+  // the primary audio is changed in the middle of PES packets
+  s.psi(PMT_PID, pmt(VIDEO, { STREAMS[0], STREAMS[2], STREAMS[1] }, 1));
+  s.packet(AUDIO, Bytes{});
+  s.packet(AUDIO, Bytes{});
+  s.packet(AUDIO2, Bytes{});
+  s.es(AUDIO, 3, 2);
+  s.es(AUDIO2, 3, 2);
+
+  const Bytes out = reference(s.data);
+  EQUALS(count(out, AUDIO), 4);
+  EQUALS(count(out, AUDIO2), 1 + 3);
+  EQUALS(sameAsReference(s.data), true);
+
+  // with aligned switching, AUDIO stops and AUDIO2 starts at a PES boundary
+  const Options align = { false, true, false };
+  const Bytes aligned = reference(s.data, align);
+  EQUALS(count(aligned, AUDIO), 4 + 2);
+  EQUALS(count(aligned, AUDIO2), 3);
+}
+
+void testRandomAccess() {
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  s.es(VIDEO, 2);
+  s.psi(PMT_PID, pmt(VIDEO, STREAMS));
+  s.es(VIDEO, 2);
+  s.es(AUDIO, 2);
+  s.packet(VIDEO, Bytes{}, false, true);  // not the start of a PES packet
+  s.es(AUDIO, 1);
+  s.adaptationOnly(VIDEO);
+  s.packet(TS::PID::Null, Bytes{});
+  s.packet(TS::PID::Null, Bytes{});
+  s.packet(OTHER, Bytes{});
+  s.packet(VIDEO, Bytes{}, true, true);   // random access point
+  s.es(VIDEO, 2);
+  s.packet(AUDIO, Bytes{}, false);
+  s.es(AUDIO, 2);
+  // PIDs without PES packets resume without payload_unit_start_indicator
+  for (int i = 0; i < 5; ++i)
+    s.packet(TS::PID::Null, Bytes{});
+  s.packet(OTHER, Bytes{});
+  s.adaptationOnly(VIDEO);
+
+  const Options wait = { false, false, true };
+  const Bytes out = reference(s.data, wait);
+  EQUALS(count(out, TS::PID::PAT), 1);
+  EQUALS(count(out, PMT_PID), 1);
+  EQUALS(count(out, VIDEO), 3 + 1);
+  EQUALS(count(out, AUDIO), 2);
+  EQUALS(count(out, TS::PID::Null), 5);
+  EQUALS(count(out, OTHER), 1);
+  EQUALS(pids(out)[2], VIDEO);
+  EQUALS(sameAsReference(s.data), true);
+
+  const Bytes plain = reference(s.data);
+  EQUALS(count(plain, TS::PID::Null), 7);
+  EQUALS(count(plain, OTHER), 2);
+}
+
+// a valid PMT after `hostile` still takes effect
+bool recovers(const Builder &hostile) {
+  Builder s = hostile;
+  s.psi(PMT_PID, pmt(VIDEO, STREAMS));
+  s.es(AUDIO2, 2);
+  return count(reference(s.data), AUDIO2) == count(reference(hostile.data), AUDIO2)
+      && sameAsReference(s.data);
+}
+
+Builder patAndPmt() {
+  Builder s;
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  return s;
+}
+
+void testMalformed() {
+  // section_length out of range
+  Bytes sections = pmt(VIDEO, STREAMS);
+  sections[1] = 0xbf;
+  sections[2] = 0xff;
+  Builder s = patAndPmt();
+  s.psi(PMT_PID, sections);
+  s.es(AUDIO2, 2);
+  EQUALS(count(reference(s.data), AUDIO2), 2);
+  EQUALS(recovers(s), true);
+
+  // section_length too short for the section header and CRC
+  sections = pmt(VIDEO, STREAMS);
+  sections[1] = 0xb0;
+  sections[2] = 0x05;
+  s = patAndPmt();
+  s.psi(PMT_PID, sections);
+  EQUALS(recovers(s), true);
+
+  sections = pat({ { 1, PMT_PID } });
+  sections[2] = 0x09;
+  s = Builder();
+  s.psi(TS::PID::PAT, sections);
+  s.psi(TS::PID::PAT, pat({ { 1, PMT_PID } }));
+  EQUALS(recovers(s), true);
+
+  // program_info_length beyond the section
+  sections = pmt(VIDEO, STREAMS);
+  sections[10] = 0xff;
+  sections[11] = 0xff;
+  s = patAndPmt();
+  s.psi(PMT_PID, sections);
+  s.es(AUDIO2, 2);
+  EQUALS(count(reference(s.data), AUDIO2), 2);
+  EQUALS(recovers(s), true);
+
+  // ES_info_length beyond the section
+  sections = pmt(VIDEO, STREAMS);
+  sections[12 + 3] = 0xff;
+  sections[12 + 4] = 0xff;
+  s = patAndPmt();
+  s.psi(PMT_PID, sections);
+  s.es(VIDEO, 2);
+  s.es(AUDIO2, 2);
+  // the first entry (VIDEO) is read, then the iteration stops,
+  // so AUDIO2 is never listed to drop
+  EQUALS(count(reference(s.data), VIDEO), 2);
+  EQUALS(count(reference(s.data), AUDIO2), 2);
+  EQUALS(recovers(s), true);
+
+  // a PMT of only the section header
+  sections = section(0x02, 1, 0, 0, 0, Bytes{});
+  s = patAndPmt();
+  s.psi(PMT_PID, sections);
+  EQUALS(recovers(s), true);
+
+  // adaptation_field_length beyond the packet
+  s = patAndPmt();
+  s.packet(PMT_PID, Bytes{}, true, true);
+  s.data[s.data.size() - 184] = 0xff;
+  EQUALS(recovers(s), true);
+
+  // sections which never reach the last section
+  Bytes large;
+  for (int i = 0; i < 20; ++i) {
+    const Bytes p = section(0x80, 1, 0, 0, 1, Bytes(4093 - 9, 0x00));
+    large.insert(large.end(), p.begin(), p.end());
+  }
+  EQUALS(large.size() > TS::PSI::MAX_SIZE, true);
+  s = patAndPmt();
+  s.psi(PMT_PID, large);
+  EQUALS(recovers(s), true);
+}
+
+void testRandomInput() {
+  std::mt19937 rng(1);
+
+  // random bytes with sync-bytes here and there
+  std::set<Bytes> inputs;
+  for (int n = 0; n < 20; ++n) {
+    Bytes input = basicStream().data;
+    for (int i = 0; i < 50; ++i)
+      input[rng() % input.size()] = (rng() % 4) ? rng() : TS::Packet::SYNCBYTE;
+    inputs.insert(input);
+    EQUALS(sameAsReference(input), true);
+  }
+  EQUALS(inputs.size(), 20u);
+
+  // broken PAT and PMT
+  const Bytes clean = basicStream().data;
+  inputs.clear();
+  for (int n = 0; n < 20; ++n) {
+    Bytes input = clean;
+    for (int i = 0; i < 3; ++i)
+      input[1 + rng() % (TS::Packet::SIZE * 2 - 1)] = rng();
+    inputs.insert(input);
+    EQUALS(sameAsReference(input), true);
+  }
+  EQUALS(inputs.size(), 20u);
+}
+
+
+int main() {
+
+  testBasic();
+  testMultiSection();
+  testSplitPSI();
+  testContinuity();
+  testSyncLoss();
+  testPacketSize192();
+  testVersionChange();
+  testRandomAccess();
+  testMalformed();
+  testRandomInput();
+
+  return failCount;
+}
@@ -0,0 +1,64 @@
+// libFuzzer harness for PSI::feed() and the section iterators.
+// The input is split into packets and fed as PAT and PMT, then all the
+// input is pushed to a Filter.
+//
+//   make fuzz && ./psi-fuzz
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "filter.h"
+
+static void walkPAT(const TS::PSI &psi) {
+  TS::PATSection section = psi.firstSection();
+  for (;;) {
+    auto iterator = section.iterator();
+    while (iterator.hasNext()) {
+      const auto entry = iterator.next();
+      (void)entry.programNumber();
+      (void)entry.pid();
+    }
+    if (section.isLastSection())
+      break;
+    section = section.nextSection();
+  }
+}
+
+static void walkPMT(const TS::PSI &psi) {
+  TS::PMTSection section = psi.firstSection();
+  for (;;) {
+    if (section.hasProgramInfo())
+      (void)section.pcrPid();
+    auto iterator = section.iterator();
+    while (iterator.hasNext()) {
+      const auto entry = iterator.next();
+      (void)entry.streamType();
+      (void)entry.elementaryPid();
+    }
+    if (section.isLastSection())
+      break;
+    section = section.nextSection();
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  TS::PSI pat;
+  TS::PSI pmt;
+  u_int8_t packet[TS::Packet::SIZE];
+
+  for (size_t pos = 0; pos < size; pos += TS::Packet::SIZE) {
+    const size_t len = size - pos < TS::Packet::SIZE ? size - pos : TS::Packet::SIZE;
+    memset(packet, 0xff, sizeof(packet));
+    memcpy(packet, data + pos, len);
+    const TS::Packet p(packet);
+    if (pat.feed(p))
+      walkPAT(pat);
+    if (pmt.feed(p))
+      walkPMT(pmt);
+  }
+
+  TS::Filter filter([](const u_int8_t *, size_t) {});
+  filter.setWaitRandomAccess(true);
+  filter.push(data, size);
+  return 0;
+}
@@ -24,19 +24,49 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <stdio.h>
+#include <string.h>
 
 #include "ts.h"
 
 namespace TS {
 
-bool Packet::read(FILE *fin) {
-  size_t len = fread(data, 1, SIZE, fin);
-  return len == SIZE;
+constexpr size_t Packet::SIZE;
+constexpr u_int8_t Packet::SYNCBYTE;
+constexpr size_t PSI::MAX_SIZE;
+
+ContinuityChecker::ContinuityChecker() {
+  memset(state, 0, sizeof(state));
+  memset(losses, 0, sizeof(losses));
 }
 
-void Packet::write(FILE *fout) {
-  fwrite(data, SIZE, 1, fout);
+ContinuityChecker::Result ContinuityChecker::checkSlow(const Packet &packet, int pid, int counter) {
+  if (pid == PID::Null || packet.transportErrorIndicator())
+    return CONTINUOUS;
+
+  if (packet.hasAdaptationField()
+      && packet.adaptationFieldLength() > 0
+      && packet.discontinuityIndicator()) {
+    state[pid] = packet.hasPayload() ? (VALID | ((counter + 1) & COUNTER_MASK)) : 0;
+    return CONTINUOUS;
+  }
+
+  if (!packet.hasPayload())
+    return CONTINUOUS;
+
+  const u_int8_t s = state[pid];
+  const int expected = s & COUNTER_MASK;
+  Result result = CONTINUOUS;
+  if ((s & VALID) && counter != expected) {
+    if (counter == ((expected - 1) & COUNTER_MASK) && !(s & DUPLICATED)) {
+      state[pid] = s | DUPLICATED;
+      return DUPLICATE;
+    }
+    losses[pid] += (counter - expected) & COUNTER_MASK;
+    result = DISCONTINUOUS;
+  }
+
+  state[pid] = VALID | ((counter + 1) & COUNTER_MASK);
+  return result;
 }
 
 PSI::PSI()
@@ -61,12 +91,22 @@ bool PSI::feed(const Packet &packet) {
   nextCounter = (counter + 1) % 16;
 
   Payload payload = packet.payload();
+  if (data.size() + payload.size > MAX_SIZE) {
+    data.clear();
+    nextCounter = -1;
+    return false;
+  }
   data.insert(data.end(), payload.data, payload.data + payload.size);
 
   PSISection section = firstSection();
   for (;;) {
-    if (!section.isComplete())
+    if (!section.isComplete()) {
+      if (section.isBroken()) {
+        data.clear();
+        nextCounter = -1;
+      }
       return false;
+    }
     if (section.isLastSection())
       return true;
     section = section.nextSection();
@@ -76,14 +116,14 @@ bool PSI::feed(const Packet &packet) {
 PSISection PSI::firstSection() const {
   const size_t dataSize = data.size();
   if (dataSize > 0) {
-    const int pos = pointerField() + 1;
+    const size_t pos = pointerField() + 1;
     if (pos < dataSize) {
       return PSISection(&data[pos], dataSize - pos);
     }
   }
 
   // return incomplete section
-  return PSISection(&data[0], 0);
+  return PSISection(data.data(), 0);
 }
 
 } // namespace
@@ -27,7 +27,6 @@
 #ifndef TS_H_
 #define TS_H_
 
-#include <stdio.h>
 #include <sys/types.h>
 
 #include <vector>
@@ -46,6 +45,98 @@ namespace PID {
   constexpr int CAT = 0x0001;
   constexpr int TDT = 0x0002;
   constexpr int Null = 0x1fff;
+
+  constexpr int Count = 0x2000;  // number of PID values
+};
+
+
+//
+// ISO/IEC 13818-1 Header layouts
+//
+namespace Layout {
+
+  // Transport packet header
+  struct PacketHeader {
+    typedef HEADER<4> Decoder;
+    typedef FIELD<0,8>   SyncByte;
+    typedef FIELD<8,1>   TransportErrorIndicator;
+    typedef FIELD<9,1>   PayloadUnitStartIndicator;
+    typedef FIELD<10,1>  TransportPriority;
+    typedef FIELD<11,13> Pid;
+    typedef FIELD<24,2>  TransportScramblingControl;
+    typedef FIELD<26,1>  AdaptationFieldFlag;
+    typedef FIELD<27,1>  PayloadFlag;
+    typedef FIELD<28,4>  ContinuityCounter;
+  };
+
+  // Adaptation field (length and flags)
+  struct AdaptationField {
+    typedef HEADER<2> Decoder;
+    typedef FIELD<0,8>  AdaptationFieldLength;
+    typedef FIELD<8,1>  DiscontinuityIndicator;
+    typedef FIELD<9,1>  RandomAccessIndicator;
+    typedef FIELD<10,1> ElementaryStreamPriorityIndicator;
+    typedef FIELD<11,1> PcrFlag;
+    typedef FIELD<12,1> OpcrFlag;
+    typedef FIELD<13,1> SplicingPointFlag;
+    typedef FIELD<14,1> TransportPrivateDataFlag;
+    typedef FIELD<15,1> AdaptationFieldExtensionFlag;
+  };
+
+  // PCR / OPCR in the adaptation field
+  struct ClockReference {
+    typedef HEADER<6> Decoder;
+    typedef FIELD<0,33> Base;
+    typedef FIELD<39,9> Extension;
+  };
+
+  // Section header (the part common to all sections)
+  struct SectionHeader {
+    typedef HEADER<3> Decoder;
+    typedef FIELD<0,8>  TableId;
+    typedef FIELD<8,1>  SectionSyntaxIndicator;
+    typedef FIELD<12,12> SectionLength;
+  };
+
+  // Section header following the section_length
+  // (section_syntax_indicator == 1)
+  struct SectionSyntax {
+    typedef HEADER<8> Decoder;
+    typedef FIELD<24,16> TableIdExtension;
+    typedef FIELD<42,5>  VersionNumber;
+    typedef FIELD<47,1>  CurrentNextIndicator;
+    typedef FIELD<48,8>  SectionNumber;
+    typedef FIELD<56,8>  LastSectionNumber;
+  };
+
+  // PES packet header up to PES_packet_length
+  struct PESHeader {
+    typedef HEADER<6> Decoder;
+    typedef FIELD<0,24>  PacketStartCodePrefix;
+    typedef FIELD<24,8>  StreamId;
+    typedef FIELD<32,16> PESPacketLength;
+  };
+
+  // PES packet header flags following PES_packet_length
+  struct PESOptionalHeader {
+    typedef HEADER<3> Decoder;
+    typedef FIELD<2,2>  PESScramblingControl;
+    typedef FIELD<4,1>  PESPriority;
+    typedef FIELD<5,1>  DataAlignmentIndicator;
+    typedef FIELD<6,1>  Copyright;
+    typedef FIELD<7,1>  OriginalOrCopy;
+    typedef FIELD<8,2>  PtsDtsFlags;
+    typedef FIELD<16,8> PESHeaderDataLength;
+  };
+
+  // PTS / DTS
+  struct Timestamp {
+    typedef HEADER<5> Decoder;
+    typedef FIELD<4,3>   Bits32to30;
+    typedef FIELD<8,15>  Bits29to15;
+    typedef FIELD<24,15> Bits14to0;
+  };
+
 };
 
 
@@ -63,56 +154,48 @@ struct Payload {
 //
 // ISO/IEC 13818-1 Transport packet
 //
+// Packet refers to SIZE bytes owned by the caller; the bytes must stay
+// valid while the Packet is in use.
+//
 class Packet {
+  typedef Layout::PacketHeader H;
+  typedef Layout::AdaptationField AF;
+  typedef Layout::ClockReference CR;
+
 public:
   static constexpr size_t SIZE = 188;
   static constexpr u_int8_t SYNCBYTE = 0x47;
 
-  Packet() : data() {}
-
-  // returns true if SIZE bytes were read in
-  bool read(FILE *fin);
+  explicit Packet(const u_int8_t *data_) : data(data_), header(data_) {}
 
-  void write(FILE *fout);
-
-  int  syncByte()                   const { return INT<0,8>::get(data); }
-  bool transportErrorIndicator()    const { return BIT<8>::get(data); }
-  bool payloadUnitStartIndicator()  const { return BIT<9>::get(data); }
-  bool transportPriority()          const { return BIT<10>::get(data); }
-  int  pid()                        const { return INT<11,13>::get(data); }
-  int  transportScramblingControl() const { return INT<24,2>::get(data); }
-  bool hasAdaptationField()         const { return BIT<26>::get(data); }
-  bool hasPayload()                 const { return BIT<27>::get(data); }
-  int  continuityCounter()          const { return INT<28,4>::get(data); }
+  int  syncByte()                   const { return header.get<H::SyncByte>(); }
+  bool transportErrorIndicator()    const { return header.get<H::TransportErrorIndicator>(); }
+  bool payloadUnitStartIndicator()  const { return header.get<H::PayloadUnitStartIndicator>(); }
+  bool transportPriority()          const { return header.get<H::TransportPriority>(); }
+  int  pid()                        const { return header.get<H::Pid>(); }
+  int  transportScramblingControl() const { return header.get<H::TransportScramblingControl>(); }
+  bool hasAdaptationField()         const { return header.get<H::AdaptationFieldFlag>(); }
+  bool hasPayload()                 const { return header.get<H::PayloadFlag>(); }
+  int  continuityCounter()          const { return header.get<H::ContinuityCounter>(); }
 
   // Adaptation field
   // These values are valid only if hasAdaptationField() returns true.
-  int  adaptationFieldLength()      const { return INT<32,8>::get(data); }
-  bool discontinuityIndicator()     const { return BIT<40>::get(data); }
-  bool randomAccessIndicator()      const { return BIT<41>::get(data); }
-  bool elementaryStreamPriorityIndicator() const { return BIT<42>::get(data); }
-  bool pcrFlag()                    const { return BIT<43>::get(data); }
-  bool opcrFlag()                   const { return BIT<44>::get(data); }
-  bool splicingPointFlag()          const { return BIT<45>::get(data); }
-  bool transportPrivateDataFlag()   const { return BIT<46>::get(data); }
-  bool adaptationFieldExtensionFlag() const { return BIT<47>::get(data); }
+  int  adaptationFieldLength()      const { return adaptationField().get<AF::AdaptationFieldLength>(); }
+  bool discontinuityIndicator()     const { return adaptationField().get<AF::DiscontinuityIndicator>(); }
+  bool randomAccessIndicator()      const { return adaptationField().get<AF::RandomAccessIndicator>(); }
+  bool elementaryStreamPriorityIndicator() const { return adaptationField().get<AF::ElementaryStreamPriorityIndicator>(); }
+  bool pcrFlag()                    const { return adaptationField().get<AF::PcrFlag>(); }
+  bool opcrFlag()                   const { return adaptationField().get<AF::OpcrFlag>(); }
+  bool splicingPointFlag()          const { return adaptationField().get<AF::SplicingPointFlag>(); }
+  bool transportPrivateDataFlag()   const { return adaptationField().get<AF::TransportPrivateDataFlag>(); }
+  bool adaptationFieldExtensionFlag() const { return adaptationField().get<AF::AdaptationFieldExtensionFlag>(); }
+
+  // PCR / OPCR in 27MHz units
   int64_t pcr() const {
-    const u_int8_t *p = &data[6];
-    return ((int64_t)p[0] << 40)
-         | ((int64_t)p[1] << 32)
-         | ((int64_t)p[2] << 24)
-         | ((int64_t)p[3] << 16)
-         | ((int64_t)p[4] << 8)
-         | ((int64_t)p[5]);
+    return clockReference(&data[6]);
   }
   int64_t opcr() const {
-    const u_int8_t *p = &data[6 + pcrFlag() * 6];
-    return ((int64_t)p[0] << 40)
-         | ((int64_t)p[1] << 32)
-         | ((int64_t)p[2] << 24)
-         | ((int64_t)p[3] << 16)
-         | ((int64_t)p[4] << 8)
-         | ((int64_t)p[5]);
+    return clockReference(&data[6 + pcrFlag() * 6]);
   }
   int spliceCountdown() const {
     const u_int8_t *p = &data[6 + (pcrFlag() + opcrFlag()) * 6];
@@ -121,13 +204,126 @@ public:
 
   // Payload
   // The returned value is valid only if hasPayload() returns true.
+  // The payload is empty if the adaptation field overruns the packet.
   Payload payload() const {
-    const int index = hasAdaptationField() ? (4 + 1 + adaptationFieldLength()) : 4;
+    const size_t index = hasAdaptationField() ? (4 + 1 + adaptationFieldLength()) : 4;
+    if (index > SIZE)
+      return Payload(&data[SIZE], 0);
     return Payload(&data[index], SIZE - index);
   }
 
 private:
-  u_int8_t data[SIZE];
+  const u_int8_t *data;
+  const H::Decoder header;
+
+  AF::Decoder adaptationField() const { return AF::Decoder(&data[4]); }
+
+  static int64_t clockReference(const u_int8_t *p) {
+    const CR::Decoder cr(p);
+    return cr.get<CR::Base>() * 300 + cr.get<CR::Extension>();
+  }
+};
+
+//
+// ISO/IEC 13818-1 PES packet header
+//
+// PESHeader refers to the payload of the transport packet which starts a
+// PES packet (payloadUnitStartIndicator() == true).
+//
+class PESHeader {
+  typedef Layout::PESHeader H;
+  typedef Layout::PESOptionalHeader OH;
+  typedef Layout::Timestamp T;
+
+public:
+  PESHeader(const Payload &payload) : data(payload.data), size(payload.size) {}
+
+  // returns true if the header fits in the payload, and the header data
+  // has room for the PTS / DTS announced by ptsDtsFlags()
+  bool isValid() const {
+    if (size < 9 || H::Decoder(data).get<H::PacketStartCodePrefix>() != 1)
+      return false;
+    const size_t headerDataLength = pesHeaderDataLength();
+    const size_t timestampsLength = hasDts() ? 10 : hasPts() ? 5 : 0;
+    return headerDataLength >= timestampsLength && size >= 9 + headerDataLength;
+  }
+
+  int streamId()          const { return H::Decoder(data).get<H::StreamId>(); }
+  int pesPacketLength()   const { return H::Decoder(data).get<H::PESPacketLength>(); }
+
+  // These values are valid only if the stream has the optional PES header.
+  int  pesScramblingControl()   const { return optionalHeader().get<OH::PESScramblingControl>(); }
+  bool dataAlignmentIndicator() const { return optionalHeader().get<OH::DataAlignmentIndicator>(); }
+  int  ptsDtsFlags()            const { return optionalHeader().get<OH::PtsDtsFlags>(); }
+  int  pesHeaderDataLength()    const { return optionalHeader().get<OH::PESHeaderDataLength>(); }
+
+  bool hasPts() const { return (ptsDtsFlags() & 2) != 0; }
+  bool hasDts() const { return ptsDtsFlags() == 3; }
+
+  // PTS / DTS in 90kHz units
+  // These values are valid only if isValid() and hasPts() / hasDts() return true.
+  int64_t pts() const { return timestamp(&data[9]); }
+  int64_t dts() const { return timestamp(&data[14]); }
+
+private:
+  const u_int8_t *data;
+  size_t size;
+
+  OH::Decoder optionalHeader() const { return OH::Decoder(&data[6]); }
+
+  static int64_t timestamp(const u_int8_t *p) {
+    const T::Decoder ts(p);
+    return (ts.get<T::Bits32to30>() << 30)
+         | (ts.get<T::Bits29to15>() << 15)
+         | ts.get<T::Bits14to0>();
+  }
+};
+
+//
+// ISO/IEC 13818-1 Continuity counter check
+//
+// Tracks the continuity_counter of every PID in a flat table indexed by
+// PID. Packets without payload and packets of the null PID don't advance
+// the counter. A packet with the discontinuity_indicator restarts the
+// check of its PID.
+//
+class ContinuityChecker {
+public:
+  enum Result {
+    CONTINUOUS,
+    DUPLICATE,      // same counter as the previous packet (sent twice)
+    DISCONTINUOUS,  // some packets were lost
+  };
+
+  ContinuityChecker();
+
+  Result check(const Packet &packet) {
+    const int pid = packet.pid();
+    const int counter = packet.continuityCounter();
+    if (state[pid] == (VALID | counter) && !packet.hasAdaptationField() && packet.hasPayload()) {
+      state[pid] = VALID | ((counter + 1) & COUNTER_MASK);
+      return CONTINUOUS;
+    }
+    return checkSlow(packet, pid, counter);
+  }
+
+  // estimated number of packets lost.
+  // the estimate is modulo 16, so it may be less than the actual number.
+  // returns 0 if pid is out of range.
+  unsigned long lossCount(int pid) const {
+    return (pid >= 0 && pid < PID::Count) ? losses[pid] : 0;
+  }
+
+private:
+  // state of each PID
+  static constexpr u_int8_t COUNTER_MASK = 0x0f;  // next expected counter
+  static constexpr u_int8_t VALID = 0x10;         // counter has been received
+  static constexpr u_int8_t DUPLICATED = 0x20;    // previous packet was a duplicate
+
+  u_int8_t state[PID::Count];
+  u_int32_t losses[PID::Count];
+
+  Result checkSlow(const Packet &packet, int pid, int counter);
 };
 
 // forward declaration
@@ -138,9 +334,14 @@ class PSISection;
 // 
 class PSI {
 public:
+  // upper limit of the buffered data.
+  // sections which don't fit in are discarded.
+  static constexpr size_t MAX_SIZE = 64 * 1024;
+
   PSI();
 
-  // returns true if all sections were read in
+  // returns true if all sections were read in.
+  // broken or oversized sections are discarded.
   bool feed(const Packet &packet);
 
   int pointerField() const { return data[0]; }
@@ -163,8 +364,20 @@ public:
   PSISection(const PSISection &s)
     : data(s.data), size(s.size) { }
 
+  // upper limits of section_length
+  static constexpr int MAX_SECTION_LENGTH = 1021;          // PAT, CAT and PMT
+  static constexpr int MAX_PRIVATE_SECTION_LENGTH = 4093;
+
+  // lower limit of section_length: the fields up to last_section_number and CRC
+  static constexpr int MIN_SECTION_LENGTH = 5 + 4;
+
   bool isComplete() const {
-    return canDetermineSectionSize() && size >= sectionSize();
+    return isValid() && size >= static_cast<size_t>(sectionSize());
+  }
+
+  // returns true if the header was read in and section_length is out of range
+  bool isBroken() const {
+    return canDetermineSectionSize() && !isValid();
   }
 
   bool isLastSection() const {
@@ -176,29 +389,40 @@ public:
     return PSISection(&data[sectSize], size - sectSize);
   }
 
-  int  tableId()                const { return INT<0,8>::get(data); }
-  bool sectionSyntaxIndicator() const { return BIT<8>::get(data); }
-  int  sectionLength()          const { return INT<12,12>::get(data); }
+  int  tableId()                const { return header().get<SH::TableId>(); }
+  bool sectionSyntaxIndicator() const { return header().get<SH::SectionSyntaxIndicator>(); }
+  int  sectionLength()          const { return header().get<SH::SectionLength>(); }
 
-  int  versionNumber()          const { return INT<42,5>::get(data); }
-  bool currentNextIndicator()   const { return BIT<47>::get(data); }
-  int  sectionNumber()          const { return INT<48,8>::get(data); }
-  int  lastSectionNumber()      const { return INT<56,8>::get(data); }
+  int  tableIdExtension()       const { return syntax().get<SS::TableIdExtension>(); }
+  int  versionNumber()          const { return syntax().get<SS::VersionNumber>(); }
+  bool currentNextIndicator()   const { return syntax().get<SS::CurrentNextIndicator>(); }
+  int  sectionNumber()          const { return syntax().get<SS::SectionNumber>(); }
+  int  lastSectionNumber()      const { return syntax().get<SS::LastSectionNumber>(); }
 
   u_int32_t crc() const {
-    const u_int8_t * const p = &data[sectionSize() - 4];
-    return ((u_int32_t)p[0] << 24)
-         | ((u_int32_t)p[1] << 16)
-         | ((u_int32_t)p[2] << 8)
-         | ((u_int32_t)p[3]);
+    return LOAD<4>::get(&data[sectionSize() - 4]);
   }
 
 protected:
+  typedef Layout::SectionHeader SH;
+  typedef Layout::SectionSyntax SS;
+
   const u_int8_t *data;
   size_t size;
 
+  SH::Decoder header() const { return SH::Decoder(data); }
+  SS::Decoder syntax() const { return SS::Decoder(data); }
+
   bool canDetermineSectionSize() const { return size >= 3; }
   int sectionSize() const { return 3 + sectionLength(); }
+
+  bool isValid() const {
+    if (!canDetermineSectionSize())
+      return false;
+    const int length = sectionLength();
+    const int maxLength = tableId() <= 0x02 ? MAX_SECTION_LENGTH : MAX_PRIVATE_SECTION_LENGTH;
+    return length >= MIN_SECTION_LENGTH && length <= maxLength;
+  }
 };
 
 
@@ -206,6 +430,8 @@ class PATSection : public PSISection {
 public:
   class Entry {
   public:
+    static constexpr size_t SIZE = 4;
+
     Entry(const u_int8_t *data_) : data(data_) { }
     Entry(const Entry &e) : data(e.data) { }
 
@@ -220,11 +446,11 @@ public:
     Iterator(const u_int8_t *ptr, size_t size) : nextPtr(ptr), endPtr(ptr + size) {}
     Iterator(const Iterator &it) : nextPtr(it.nextPtr), endPtr(it.endPtr) {}
 
-    bool hasNext() const { return nextPtr < endPtr; }
+    bool hasNext() const { return static_cast<size_t>(endPtr - nextPtr) >= Entry::SIZE; }
 
     Entry next() {
       const u_int8_t * const p = nextPtr;
-      nextPtr += 4;
+      nextPtr += Entry::SIZE;
       return Entry(p);
     }
 
@@ -246,6 +472,9 @@ class PMTSection : public PSISection {
 public:
   class Entry {
   public:
+    // size of the fields before the descriptors
+    static constexpr size_t SIZE = 5;
+
     Entry(const u_int8_t *data_) : data(data_) { }
     Entry(const Entry &e) : data(e.data) { }
 
@@ -261,11 +490,13 @@ public:
     Iterator(const u_int8_t *ptr, size_t size) : nextPtr(ptr), endPtr(ptr + size) {}
     Iterator(const Iterator &it) : nextPtr(it.nextPtr), endPtr(it.endPtr) {}
 
-    bool hasNext() const { return nextPtr < endPtr; }
+    bool hasNext() const { return static_cast<size_t>(endPtr - nextPtr) >= Entry::SIZE; }
 
     Entry next() {
       Entry ent(nextPtr);
-      nextPtr += 5 + ent.esInfoLength();
+      const size_t rest = endPtr - nextPtr;
+      const size_t entrySize = Entry::SIZE + ent.esInfoLength();
+      nextPtr += entrySize < rest ? entrySize : rest;
       return ent;
     }
 
@@ -276,12 +507,23 @@ public:
 
   PMTSection(const PSISection &s) : PSISection(s) {}
 
+  // size of the fields before the program info descriptors
+  static constexpr int HEADER_SIZE = 12;
+
+  // These values are valid only if hasProgramInfo() returns true.
   int pcrPid() const { return INT<67,13>::get(data); }
   int programInfoLength() const { return INT<84,12>::get(data); }
 
+  bool hasProgramInfo() const { return sectionSize() - 4 >= HEADER_SIZE; }
+
   Iterator iterator() {
-    const int entryPos = 12 + programInfoLength();
-    return Iterator(data + entryPos, sectionSize() - entryPos - 4);
+    const int endPos = sectionSize() - 4;
+    if (!hasProgramInfo())
+      return Iterator(data + endPos, 0);
+    const int entryPos = HEADER_SIZE + programInfoLength();
+    if (entryPos > endPos)
+      return Iterator(data + endPos, 0);
+    return Iterator(data + entryPos, endPos - entryPos);
   }
 };
 
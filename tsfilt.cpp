@@ -29,21 +29,7 @@
 #include <stdarg.h>
 #include <sys/types.h>
 
-#include <set>
-
-#include "ts.h"
-
-std::set<int> g_pmtPidSet;
-std::set<int> g_dropPidSet;
-
-void printDebug(const char *format, ...) {
-#ifdef DEBUG
-  va_list args;
-  va_start(args, format);
-  vfprintf(stderr, format, args);
-  va_end(args);
-#endif
-}
+#include "filter.h"
 
 void printError(const char *format, ...) {
   va_list args;
@@ -52,147 +38,49 @@ void printError(const char *format, ...) {
   va_end(args);
 }
 
-void feedPAT(const TS::Packet &packet) {
-  static TS::PSI psi;
-  bool completed = psi.feed(packet);
-  if (!completed)
-    return;
-
-  printDebug("pasre PAT\n");
+struct Options {
+  bool dropDuplicates;
+  bool alignSwitching;
+  bool waitRandomAccess;
 
-  g_pmtPidSet.clear();
+  Options() : dropDuplicates(false), alignSwitching(false), waitRandomAccess(false) {}
+};
 
-  TS::PATSection section = psi.firstSection();
-  for (;;) {
-    auto iterator = section.iterator();
-    while(iterator.hasNext()) {
-      const auto entry = iterator.next();
+void filterTS(FILE *fin, FILE *fout, const Options &options) {
+  static constexpr size_t BUFFER_SIZE = TS::Packet::SIZE * 256;
+  static u_int8_t buffer[BUFFER_SIZE];
 
-      int programNumber = entry.programNumber();
-      int pid = entry.pid();
-      printDebug("PAT: prog:%d  pid:%d\n", programNumber, pid);
-      if (programNumber != 0) {
-        g_pmtPidSet.insert(pid);
-        break;
-      }
-    }
+  TS::Filter filter([fout](const u_int8_t *data, size_t size) {
+    fwrite(data, 1, size, fout);
+  });
+  filter.setDropDuplicates(options.dropDuplicates);
+  filter.setAlignSwitching(options.alignSwitching);
+  if (options.waitRandomAccess)
+    filter.setWaitRandomAccess(true);
 
-    if (section.isLastSection())
+  for(;;) {
+    const size_t len = fread(buffer, 1, BUFFER_SIZE, fin);
+    if (len == 0)
       break;
-    section = section.nextSection();
-  }
-}
 
-void feedPMT(const TS::Packet &packet) {
-  static TS::PSI psi;
-  bool completed = psi.feed(packet);
-  if (!completed)
-    return;
-
-  printDebug("pasre PMT\n");
-
-  bool hasVideo = false;
-  bool hasAudio = false;
-
-  g_dropPidSet.clear();
-
-  TS::PMTSection section = psi.firstSection();
-  for (;;) {
-    auto iterator = section.iterator();
-    while(iterator.hasNext()) {
-      const auto entry = iterator.next();
-
-      int streamType = entry.streamType();
-      int pid = entry.elementaryPid();
-      printDebug("PMT: streamType:%d  pid:%d\n", streamType, pid);
-
-      switch (streamType) {
-        case 2: // ISO/IEC 13818-2
-          if (hasVideo) {
-            g_dropPidSet.insert(pid);
-          } else {
-            hasVideo = true;
-          }
-          break;
-
-        case 0xf: // ISO/IEC 13818-7
-          if (hasAudio) {
-            g_dropPidSet.insert(pid);
-          } else {
-            hasAudio = true;
-          }
-          break;
-
-        default:
-          g_dropPidSet.insert(pid);
-          break;
-      } 
-    }
-
-    if (section.isLastSection())
-      break;
-    section = section.nextSection();
+    const auto syncLosses = filter.syncLossCount();
+    filter.push(buffer, len);
+    for (auto n = syncLosses; n < filter.syncLossCount(); ++n)
+      printError("missing sync-byte\n");
   }
-}
 
-bool checkPacket(const TS::Packet &packet) {
-  printDebug("SI:%d PID:%d hasAF:%d hasPL:%d ct:%d\n",
-    packet.payloadUnitStartIndicator(),
-    packet.pid(),
-    packet.hasAdaptationField(),
-    packet.hasPayload(),
-    packet.continuityCounter());
-
-  if (!packet.hasPayload())
-    return false;
-
-  const auto pid = packet.pid();
-
-  if (pid == TS::PID::PAT) {
-    feedPAT(packet);
-  } else if (g_pmtPidSet.find(pid) != g_pmtPidSet.end()) {
-    feedPMT(packet);
-  } else if (g_dropPidSet.find(pid) != g_dropPidSet.end()) {
-    return true;
+  for (int pid = 0; pid <= TS::PID::Null; ++pid) {
+    const auto losses = filter.lossCount(pid);
+    if (losses > 0)
+      printError("continuity error : PID 0x%04x %lu packet(s) lost\n", pid, losses);
   }
-
-  return false;
 }
 
-void filterTS(FILE *fin, FILE *fout) {
-  TS::Packet packet;
-
-  for(;;) {
-    for(;;) {
-      int c = fgetc(fin);
-      if (c == EOF)
-        return;
-      if (c == TS::Packet::SYNCBYTE)
-        break;
-    }
-
-    fseek(fin, ftell(fin) - 1, SEEK_SET);
-
-    for(;;) {
-      const auto readPos = ftell(fin);
-      if (!packet.read(fin))
-        return;
-
-      if (packet.syncByte() != TS::Packet::SYNCBYTE) {
-        printError("missing sync-byte\n");
-        fseek(fin, readPos, SEEK_SET);
-        break;
-      }
-
-      bool drop = checkPacket(packet);
-      if (drop) {
-        printDebug("--> drop\n");
-      } else {
-        printDebug("--> keep\n");
-        packet.write(fout);
-      }
-    }
-  }
+void usage() {
+  printError("usage: tsfilt [-d] [-p] [-r] [input [output]]\n");
+  printError("  -d : drop duplicate packets\n");
+  printError("  -p : start or stop streams only at PES boundaries\n");
+  printError("  -r : drop packets before the first random access point\n");
 }
 
 
@@ -200,8 +88,22 @@ int main(int argc, char **argv) {
 
   const char *inPath = nullptr;
   const char *outPath = nullptr;
+  Options options;
 
   for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      if (strcmp(argv[i], "-d") == 0) {
+        options.dropDuplicates = true;
+      } else if (strcmp(argv[i], "-p") == 0) {
+        options.alignSwitching = true;
+      } else if (strcmp(argv[i], "-r") == 0) {
+        options.waitRandomAccess = true;
+      } else {
+        usage();
+        return 1;
+      }
+      continue;
+    }
     if (!inPath) {
       inPath = argv[i];
       continue;
@@ -230,7 +132,7 @@ int main(int argc, char **argv) {
     goto FINISH;
   }
 
-  filterTS(fin, fout);
+  filterTS(fin, fout, options);
 
   fflush(fout);
 